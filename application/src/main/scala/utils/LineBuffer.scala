@@ -0,0 +1,49 @@
+/*
+ * Distributed Cluster for Computer Vision
+ * Copyright (C) 2024 Andrea Ingargiola, Bruno Esposito
+ * andrea.ingargiola@studio.unibo.it
+ * bruno.esposito@studio.unibo.it
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+package utils
+
+import akka.util.ByteString
+
+object LineBuffer:
+  private val streamTag = """(camera[0-9A-Za-z]+):(.*)""".r
+
+  /**
+   * Splits the "camera<id>:" prefix that a process serving several streams puts before each line.
+   * @return the stream tag, if any, and the line without it.
+   */
+  def splitStreamTag(line: String): (Option[String], String) =
+    line match
+      case streamTag(tag, rest) => (Option(tag), rest)
+      case _ => (Option.empty, line)
+
+/**
+ * Rebuilds the newline-terminated lines written by a child process from the raw chunks of its output source.
+ * A chunk may hold several lines or stop in the middle of one: the incomplete tail is kept for the next chunk.
+ */
+class LineBuffer(maxPending: Int = 4096):
+  private var pending: String = ""
+
+  def append(bs: ByteString): List[String] =
+    val parts = (pending + bs.utf8String).split("\n", -1)
+    // a tail without newline longer than maxPending is not a protocol line: drop it
+    pending = if (parts.last.length > maxPending) "" else parts.last
+    parts.init.map(_.strip()).filter(_.nonEmpty).toList
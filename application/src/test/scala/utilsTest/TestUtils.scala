@@ -22,10 +22,11 @@
 package utilsTest
 
 import akka.actor.testkit.typed.scaladsl.ActorTestKit
+import akka.util.ByteString
 import org.scalatest.flatspec.AnyFlatSpec
 import message.{Message, Pong}
 import utils.ActorTypes.{Undefined, Utility}
-import utils.{ConnectionController, Info}
+import utils.{ConnectionController, Info, LineBuffer}
 
 import scala.sys.process.*
 import java.net.{ServerSocket, SocketTimeoutException}
@@ -33,6 +34,7 @@ import java.net.{ServerSocket, SocketTimeoutException}
 class TestUtils extends AnyFlatSpec:
   "An Info" should "update itself recursevly mantaining not-overriden informations" in testInfo()
   "A ConnectionController" should "open and manage TCP sockets in a functional way" in testConnectionController()
+  "A LineBuffer" should "split the chunks of a child process output into complete lines" in testLineBuffer()
 
   val testKit: ActorTestKit = ActorTestKit()
   val powershellCommand: String = if(System.getProperty("os.name").toLowerCase().contains("win")) "powershell" else "pwsh"
@@ -49,6 +51,15 @@ class TestUtils extends AnyFlatSpec:
     probe ! Pong(info.setActorType(Utility))
     probe.expectMessage(Pong(Info(null, Set(), Utility)))
 
+  def testLineBuffer(): Unit =
+    val lines = LineBuffer()
+    assert(lines.append(ByteString("2:Face:12.5\ntrack:new:1:10,20,30,40\n")) == List("2:Face:12.5", "track:new:1:10,20,30,40"))
+    assert(lines.append(ByteString("heartbeat:Face:30")).isEmpty)
+    assert(lines.append(ByteString(":1.50:2:12.00:0\r\n\n")) == List("heartbeat:Face:30:1.50:2:12.00:0"))
+    assert(LineBuffer(8).append(ByteString("0123456789")).isEmpty)
+    assert(LineBuffer.splitStreamTag("camera2:track:lost:4:12") == (Option("camera2"), "track:lost:4:12"))
+    assert(LineBuffer.splitStreamTag("1:Dnn:8.5") == (Option.empty, "1:Dnn:8.5"))
+
   def testConnectionController(): Unit =
     val cc = ConnectionController(9999)
     assertThrows[SocketTimeoutException](cc.enstablishConnection())
@@ -71,7 +71,8 @@ tasks.withType<LinkExecutable>().configureEach {
         "-lopencv_videoio",
         "-lopencv_calib3d",
         "-lopencv_features2d",
-        "-lopencv_video"
+        "-lopencv_video",
+        "-lopencv_dnn"
     ))
     linkerArgs.add("-Wl,-rpath,/usr/local/lib")
     linkerArgs.add("-Wl,-rpath,\$ORIGIN/libs")
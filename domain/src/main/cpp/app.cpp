@@ -1,20 +1,34 @@
-#include <arpa/inet.h>
-#include <netinet/in.h>
-#include <sys/select.h>
-#include <sys/socket.h>
+#include "app.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <opencv2/dnn.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/objdetect.hpp>
 #include <opencv2/opencv.hpp>
 #include <opencv2/videoio.hpp>
 #include <random>
+#include <set>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <websocketpp/config/asio_no_tls.hpp>
@@ -23,17 +37,102 @@
 typedef websocketpp::server<websocketpp::config::asio> Server;
 using namespace cv;
 using namespace std;
+using namespace DCCV;
 using websocketpp::connection_hdl;
 namespace fs = std::filesystem;
 
-int manager_socket = -1;
+// Posizionamento dei thread della pipeline sui core della macchina
+struct PlacementConfig {
+  string videoCpus;      // cattura, detection Face/Body ed encoding
+  string detectCpus;     // worker DNN e pool di OpenCV, in ogni modalita'
+  string networkCpus;    // thread dell'io_service (WebSocket e CameraManager)
+  int cvThreads = -1;    // thread del pool di OpenCV, per processo
+  int fifoPriority = 0;  // priorita' SCHED_FIFO (0 = SCHED_OTHER)
+  int niceLevel = 0;     // nice del processo
+};
 
-class Detector {
-  enum Mode { Face, Body } m;
-  HOGDescriptor hog;
+// Applica affinita' e scheduling al thread corrente e stampa il risultato
+void applyThreadPlacement(const string &stage, const string &cpuSpec,
+                          int fifoPriority) {
+  pthread_t self = pthread_self();
+
+  if (!cpuSpec.empty()) {
+    cpu_set_t cpus;
+    if (!parseCpuList(cpuSpec, cpus)) {
+      cerr << "Invalid CPU list for " << stage << ": " << cpuSpec << endl;
+    } else if (int err = pthread_setaffinity_np(self, sizeof(cpus), &cpus)) {
+      cerr << "Cannot pin " << stage << " thread: " << strerror(err) << endl;
+    }
+  }
+
+  if (fifoPriority > 0) {
+    sched_param param{};
+    param.sched_priority = fifoPriority;
+    if (int err = pthread_setschedparam(self, SCHED_FIFO, &param)) {
+      cerr << "Cannot set SCHED_FIFO for " << stage
+           << " thread: " << strerror(err) << endl;
+    }
+  }
+
+  cpu_set_t effective;
+  CPU_ZERO(&effective);
+  pthread_getaffinity_np(self, sizeof(effective), &effective);
+  int policy = SCHED_OTHER;
+  sched_param param{};
+  pthread_getschedparam(self, &policy, &param);
+
+  string policyName = policy == SCHED_FIFO
+                          ? "SCHED_FIFO/" + to_string(param.sched_priority)
+                          : "SCHED_OTHER";
+  cout << "Thread placement [" << stage << "]: cpus=" << formatCpuSet(effective)
+       << " policy=" << policyName
+       << " nice=" << getpriority(PRIO_PROCESS, 0) << endl;
+}
+
+// OpenCV's parallel_for_ pool is process-wide and its workers are spawned
+// lazily by the first thread that runs a parallel region, inheriting that
+// thread's affinity (pthreads/OpenMP backends; a TBB build ignores it). The
+// stage that should own the pool calls this right after its own placement so
+// it wins the race, then the effective placement of the workers is reported.
+void placeOpenCvPool(const string &stage) {
+  static once_flag once;
+  call_once(once, [&stage] {
+    mutex m;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    set<pthread_t> threads;
+
+    parallel_for_(Range(0, max(1, getNumThreads()) * 4),
+                  [&](const Range &range) {
+                    cpu_set_t own;
+                    CPU_ZERO(&own);
+                    pthread_getaffinity_np(pthread_self(), sizeof(own), &own);
+                    lock_guard<mutex> lock(m);
+                    CPU_OR(&cpus, &cpus, &own);
+                    threads.insert(pthread_self());
+                  });
+
+    cout << "Thread placement [opencv pool, from " << stage
+         << "]: threads=" << getNumThreads() << " seen=" << threads.size()
+         << " cpus=" << formatCpuSet(cpus) << endl;
+  });
+}
+
+// Interfaccia comune ai diversi algoritmi di detection
+class DetectionBackend {
+ public:
+  virtual ~DetectionBackend() = default;
+  virtual string name() const = 0;
+  virtual vector<Rect> detect(const Mat &img) = 0;
+  virtual void adjustRect(Rect &r) const {}
+  // true se il backend ridimensiona gia' l'input a una dimensione fissa
+  virtual bool fixedInputSize() const { return false; }
+  // Parte dell'ultima detect() passata in coda invece che ad elaborare
+  virtual double lastWaitMs() const { return 0; }
+};
+
+class FaceBackend : public DetectionBackend {
   CascadeClassifier face_cascade;
-  Rect detectionWindow;
-  bool useWindow;
 
   bool loadCascadeClassifier() {
     vector<string> possiblePaths = {
@@ -63,26 +162,459 @@ class Detector {
   }
 
  public:
-  Detector(int x = 0, int y = 0, int width = 0, int height = 0)
-      : m(Face), hog() {
-    hog.setSVMDetector(HOGDescriptor::getDefaultPeopleDetector());
-    detectionWindow = Rect(x, y, width, height);
-    useWindow = (width > 0 && height > 0);
-
+  FaceBackend() {
     if (!loadCascadeClassifier()) {
-      throw runtime_error(
-          "Cannot load face cascade classifier. Using body detection only.");
-      m = Body;
+      throw runtime_error("Cannot load face cascade classifier.");
     }
   }
 
-  void toggleMode() { m = (m == Face ? Body : Face); }
-  string modeName() const { return (m == Face ? "Face" : "Body"); }
+  string name() const override { return "Face"; }
 
-  vector<Rect> detect(InputArray img) {
+  vector<Rect> detect(const Mat &img) override {
     vector<Rect> found;
     Mat gray;
+    cvtColor(img, gray, COLOR_BGR2GRAY);
+    equalizeHist(gray, gray);
+    face_cascade.detectMultiScale(gray, found, 1.1, 3, 0, Size(30, 30));
+    return found;
+  }
+
+  void adjustRect(Rect &r) const override {
+    r.x -= cvRound(r.width * 0.1);
+    r.width = cvRound(r.width * 1.2);
+    r.y -= cvRound(r.height * 0.1);
+    r.height = cvRound(r.height * 1.2);
+  }
+};
+
+class BodyBackend : public DetectionBackend {
+  HOGDescriptor hog;
+
+ public:
+  BodyBackend() {
+    hog.setSVMDetector(HOGDescriptor::getDefaultPeopleDetector());
+  }
+
+  string name() const override { return "Body"; }
+
+  vector<Rect> detect(const Mat &img) override {
+    vector<Rect> found;
+    hog.detectMultiScale(img, found, 0, Size(8, 8), Size(), 1.05, 2, false);
+    return found;
+  }
+
+  void adjustRect(Rect &r) const override {
+    r.x += cvRound(r.width * 0.1);
+    r.width = cvRound(r.width * 0.8);
+    r.y += cvRound(r.height * 0.07);
+    r.height = cvRound(r.height * 0.8);
+  }
+};
+
+// Configurazione del backend DNN su CPU
+struct DnnConfig {
+  string model;                // modello SSD o YOLO (ONNX, Caffe, TensorFlow)
+  string config;               // prototxt/pbtxt dei modelli Caffe e TensorFlow
+  int inputSize = 320;         // lato dell'input della rete
+  int batchSize = 4;           // frame massimi per forward pass
+  int maxWaitMs = 10;          // attesa massima per riempire un batch
+  float confThreshold = 0.5f;  // confidenza minima
+  float nmsThreshold = 0.45f;  // soglia della non-maximum suppression
+  int classId = 0;             // classe da tenere (-1 = tutte)
+};
+
+// Runs a single cv::dnn network on the CPU for every stream of the process.
+// Streams submit frames and block until their batch has been processed; a
+// batch is flushed when it is full, when every attached stream is waiting, or
+// when the oldest frame has waited maxWaitMs.
+// The output layout and support for batches larger than one are probed when
+// the model is loaded: unknown layouts are rejected, and models exported with
+// a fixed batch of one fall back to one forward pass per frame.
+class DnnBatcher {
+  // Formati di output supportati
+  enum class Layout {
+    DetectionOutput,  // SSD Caffe/TensorFlow: [1, 1, N, 7]
+    BoxesScores,      // SSD ONNX: box [B, N, 4] e score [B, N, C]
+    Yolo              // YOLOv8 [B, 4 + C, N], YOLOv5 [B, N, 5 + C]
+  };
+
+  struct Request {
+    Mat frame;
+    chrono::steady_clock::time_point enqueued;
+    chrono::steady_clock::time_point dispatched;
+    vector<Rect> found;
+    bool done = false;
+  };
+
+  DnnConfig cfg;
+  PlacementConfig placement;
+  dnn::Net net;
+  vector<String> outNames;
+  Layout layout = Layout::Yolo;
+  int boxesOut = 0;  // indice dell'output con i box per BoxesScores
+  bool batched = true;
+  mutex m;
+  condition_variable workerCv;
+  condition_variable doneCv;
+  promise<void> started;
+  deque<shared_ptr<Request>> pending;
+  int streams = 0;
+  bool running = true;
+  thread worker;
+
+  // Interpreta l'output della rete per l'immagine b del batch
+  vector<Rect> parse(const vector<Mat> &outs, int b,
+                     const Size &frameSize) const {
+    vector<Rect> boxes;
+    vector<float> scores;
+    float sx = (float)frameSize.width / cfg.inputSize;
+    float sy = (float)frameSize.height / cfg.inputSize;
+
+    auto keep = [&](int cls, float conf, float x, float y, float w, float h) {
+      if (conf < cfg.confThreshold) return;
+      if (cfg.classId >= 0 && cls != cfg.classId) return;
+      boxes.emplace_back(cvRound(x), cvRound(y), cvRound(w), cvRound(h));
+      scores.push_back(conf);
+    };
+
+    if (layout == Layout::DetectionOutput) {
+      // Coordinate normalizzate, d[0] e' l'indice dell'immagine nel batch
+      const Mat &out = outs[0];
+      const float *d = out.ptr<float>();
+      for (int i = 0; i < out.size[2]; i++, d += 7) {
+        if ((int)d[0] != b) continue;
+        float x1 = d[3] * frameSize.width, y1 = d[4] * frameSize.height;
+        float x2 = d[5] * frameSize.width, y2 = d[6] * frameSize.height;
+        keep((int)d[1], d[2], x1, y1, x2 - x1, y2 - y1);
+      }
+    } else if (layout == Layout::BoxesScores) {
+      // Box normalizzati (x1, y1, x2, y2); la classe 0 e' lo sfondo
+      const Mat &boxOut = outs[boxesOut];
+      const Mat &scoreOut = outs[1 - boxesOut];
+      int classes = scoreOut.size[2];
+      const float *box = boxOut.ptr<float>(b);
+      const float *score = scoreOut.ptr<float>(b);
+      for (int i = 0; i < boxOut.size[1]; i++, box += 4, score += classes) {
+        int cls = cfg.classId;
+        if (cls < 0) {
+          cls = 1;
+          for (int c = 2; c < classes; c++) {
+            if (score[c] > score[cls]) cls = c;
+          }
+        }
+        float x1 = box[0] * frameSize.width, y1 = box[1] * frameSize.height;
+        float x2 = box[2] * frameSize.width, y2 = box[3] * frameSize.height;
+        keep(cls, score[cls], x1, y1, x2 - x1, y2 - y1);
+      }
+    } else {
+      const Mat &out = outs[0];
+      Mat rows(out.size[1], out.size[2], CV_32F,
+               (void *)out.ptr<float>(b));
+      bool transposed = rows.rows < rows.cols;
+      if (transposed) rows = rows.t();
+      int offset = transposed ? 4 : 5;
+
+      for (int i = 0; i < rows.rows; i++) {
+        const float *d = rows.ptr<float>(i);
+        Mat classScores(1, rows.cols - offset, CV_32F, (void *)(d + offset));
+        Point cls;
+        double best;
+        minMaxLoc(classScores, nullptr, &best, nullptr, &cls);
+        float conf = (float)best * (transposed ? 1.f : d[4]);
+        keep(cls.x, conf, (d[0] - d[2] / 2) * sx, (d[1] - d[3] / 2) * sy,
+             d[2] * sx, d[3] * sy);
+      }
+    }
+
+    vector<int> indices;
+    dnn::NMSBoxes(boxes, scores, cfg.confThreshold, cfg.nmsThreshold, indices);
+    vector<Rect> found;
+    for (int i : indices) found.push_back(boxes[i]);
+    return found;
+  }
+
+  vector<Mat> run(const vector<Mat> &frames) {
+    Mat blob = dnn::blobFromImages(frames, 1.0 / 255.0,
+                                   Size(cfg.inputSize, cfg.inputSize),
+                                   Scalar(), true, false);
+    net.setInput(blob);
+    vector<Mat> outs;
+    net.forward(outs, outNames);
+    return outs;
+  }
+
+  void forward(vector<shared_ptr<Request>> &batch) {
+    if (!batched) {
+      for (auto &r : batch) {
+        r->found = parse(run({r->frame}), 0, r->frame.size());
+      }
+      return;
+    }
+
+    vector<Mat> frames;
+    for (auto &r : batch) frames.push_back(r->frame);
+
+    vector<Mat> outs = run(frames);
+    for (size_t b = 0; b < batch.size(); b++) {
+      batch[b]->found = parse(outs, (int)b, batch[b]->frame.size());
+    }
+  }
 
+  static string shapes(const vector<Mat> &outs) {
+    string text;
+    for (const auto &out : outs) {
+      text += text.empty() ? "[" : " [";
+      for (int i = 0; i < out.dims; i++) {
+        text += (i ? "x" : "") + to_string(out.size[i]);
+      }
+      text += "]";
+    }
+    return text;
+  }
+
+  // Riconosce il formato dell'output con un forward su un frame vuoto, poi
+  // verifica se il modello accetta batch con piu' di un frame
+  void probe() {
+    outNames = net.getUnconnectedOutLayersNames();
+    Mat blank = Mat::zeros(cfg.inputSize, cfg.inputSize, CV_8UC3);
+    vector<Mat> outs = run({blank});
+
+    if (outs.size() == 1 && outs[0].dims == 4 && outs[0].size[3] == 7) {
+      layout = Layout::DetectionOutput;
+    } else if (outs.size() == 1 && outs[0].dims == 3) {
+      layout = Layout::Yolo;
+    } else if (outs.size() == 2 && outs[0].dims == 3 && outs[1].dims == 3 &&
+               outs[0].size[1] == outs[1].size[1] &&
+               (outs[0].size[2] == 4 || outs[1].size[2] == 4)) {
+      layout = Layout::BoxesScores;
+      boxesOut = outs[0].size[2] == 4 ? 0 : 1;
+      if (cfg.classId >= outs[1 - boxesOut].size[2]) {
+        throw runtime_error("--class " + to_string(cfg.classId) +
+                            " is not an output class of " + cfg.model);
+      }
+    } else {
+      throw runtime_error(
+          "Unsupported DNN output layout " + shapes(outs) +
+          ": expected SSD [1x1xNx7], SSD boxes [BxNx4] with scores [BxNxC], "
+          "or YOLO [Bx(4+C)xN] / [BxNx(5+C)]");
+    }
+
+    // DetectionOutput indica l'immagine di ogni riga, negli altri formati il
+    // batch e' la prima dimensione
+    if (cfg.batchSize > 1) {
+      try {
+        outs = run({blank, blank});
+        batched = layout == Layout::DetectionOutput ||
+                  all_of(outs.begin(), outs.end(),
+                         [](const Mat &out) { return out.size[0] == 2; });
+      } catch (const std::exception &) {
+        batched = false;
+      }
+      if (!batched) {
+        cerr << "DNN model " << cfg.model
+             << " does not accept batches: running one frame per forward pass"
+             << endl;
+        cfg.batchSize = 1;
+      }
+    }
+  }
+
+  void loop() {
+    applyThreadPlacement("detect", placement.detectCpus,
+                         placement.fifoPriority);
+    // net.forward() usa il pool di OpenCV: se main non l'ha gia' creato lo
+    // crea questo thread, prima degli stream video
+    placeOpenCvPool("detect");
+    try {
+      probe();
+    } catch (const std::exception &) {
+      started.set_exception(current_exception());
+      return;
+    }
+    started.set_value();
+
+    unique_lock<mutex> lock(m);
+    while (running) {
+      workerCv.wait(lock, [this] { return !running || !pending.empty(); });
+      if (!running) break;
+
+      // Il frame piu' vecchio in coda fissa la scadenza del batch
+      auto deadline =
+          pending.front()->enqueued + chrono::milliseconds(cfg.maxWaitMs);
+      workerCv.wait_until(lock, deadline, [this] {
+        return !running || (int)pending.size() >= cfg.batchSize ||
+               (int)pending.size() >= streams;
+      });
+      if (!running) break;
+
+      vector<shared_ptr<Request>> batch;
+      auto dispatched = chrono::steady_clock::now();
+      while (!pending.empty() && (int)batch.size() < cfg.batchSize) {
+        batch.push_back(pending.front());
+        batch.back()->dispatched = dispatched;
+        pending.pop_front();
+      }
+
+      lock.unlock();
+      try {
+        forward(batch);
+      } catch (const std::exception &e) {
+        cerr << "DNN forward error: " << e.what() << endl;
+      }
+      lock.lock();
+
+      for (auto &r : batch) r->done = true;
+      doneCv.notify_all();
+    }
+
+    // Sblocca gli stream ancora in attesa
+    for (auto &r : pending) r->done = true;
+    pending.clear();
+    doneCv.notify_all();
+  }
+
+ public:
+  DnnBatcher(const DnnConfig &config,
+             const PlacementConfig &threads = PlacementConfig())
+      : cfg(config), placement(threads) {
+    if (cfg.model.empty()) {
+      throw runtime_error("Dnn mode requires a model (--model)");
+    }
+    net = dnn::readNet(cfg.model, cfg.config);
+    if (net.empty()) {
+      throw runtime_error("Cannot load DNN model: " + cfg.model);
+    }
+    net.setPreferableBackend(dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(dnn::DNN_TARGET_CPU);
+
+    worker = thread(&DnnBatcher::loop, this);
+    // Gli stream partono solo dopo che il worker ha creato il pool e
+    // verificato il modello; un modello non supportato ferma l'avvio
+    try {
+      started.get_future().get();
+    } catch (...) {
+      worker.join();
+      throw;
+    }
+    cout << "Loaded DNN model " << cfg.model << " (batch " << cfg.batchSize
+         << ", max wait " << cfg.maxWaitMs << " ms)" << endl;
+  }
+
+  ~DnnBatcher() {
+    {
+      lock_guard<mutex> lock(m);
+      running = false;
+    }
+    workerCv.notify_all();
+    if (worker.joinable()) worker.join();
+  }
+
+  void attach() {
+    lock_guard<mutex> lock(m);
+    streams++;
+  }
+
+  void detach() {
+    lock_guard<mutex> lock(m);
+    streams--;
+    workerCv.notify_all();
+  }
+
+  // waitMs riceve il tempo passato in coda prima del forward pass
+  vector<Rect> detect(const Mat &img, double *waitMs = nullptr) {
+    auto request = make_shared<Request>();
+    request->frame = img;
+    request->enqueued = chrono::steady_clock::now();
+    request->dispatched = request->enqueued;
+
+    unique_lock<mutex> lock(m);
+    if (!running) return {};
+    pending.push_back(request);
+    workerCv.notify_all();
+    doneCv.wait(lock, [&] { return request->done; });
+    if (waitMs) {
+      *waitMs = chrono::duration<double, milli>(request->dispatched -
+                                                request->enqueued)
+                    .count();
+    }
+    return request->found;
+  }
+};
+
+class DnnBackend : public DetectionBackend {
+  shared_ptr<DnnBatcher> batcher;
+  double waitMs = 0;
+
+ public:
+  explicit DnnBackend(shared_ptr<DnnBatcher> b) : batcher(move(b)) {
+    batcher->attach();
+  }
+  ~DnnBackend() override { batcher->detach(); }
+
+  string name() const override { return "Dnn"; }
+
+  vector<Rect> detect(const Mat &img) override {
+    return batcher->detect(img, &waitMs);
+  }
+
+  // blobFromImages porta comunque il frame a --dnnsize
+  bool fixedInputSize() const override { return true; }
+
+  // Attesa di un batch pieno o dei frame degli altri stream
+  double lastWaitMs() const override { return waitMs; }
+};
+
+class Detector {
+  unique_ptr<DetectionBackend> backend;
+  shared_ptr<DnnBatcher> batcher;
+  Rect detectionWindow;
+  bool useWindow;
+
+  unique_ptr<DetectionBackend> makeBackend(const string &mode) {
+    if (mode == "Face") return make_unique<FaceBackend>();
+    if (mode == "Body") return make_unique<BodyBackend>();
+    if (mode == "Dnn") {
+      if (!batcher) {
+        throw runtime_error("Dnn mode requires a model (--model)");
+      }
+      return make_unique<DnnBackend>(batcher);
+    }
+    throw runtime_error("Unknown detection mode: " + mode);
+  }
+
+  // Esegue la detection su una copia ridotta e riporta i box alla scala
+  // originale
+  vector<Rect> detectScaled(const Mat &img, double scale) {
+    if (scale >= 1.0 || backend->fixedInputSize()) return backend->detect(img);
+
+    Mat small;
+    resize(img, small, Size(), scale, scale, INTER_AREA);
+    vector<Rect> found = backend->detect(small);
+    for (auto &r : found) {
+      r = Rect(cvRound(r.x / scale), cvRound(r.y / scale),
+               cvRound(r.width / scale), cvRound(r.height / scale));
+    }
+    return found;
+  }
+
+ public:
+  Detector(int x = 0, int y = 0, int width = 0, int height = 0,
+           const string &mode = "Face",
+           shared_ptr<DnnBatcher> dnnBatcher = nullptr)
+      : batcher(move(dnnBatcher)) {
+    detectionWindow = Rect(x, y, width, height);
+    useWindow = (width > 0 && height > 0);
+    backend = makeBackend(mode);
+  }
+
+  void toggleMode() {
+    backend = makeBackend(backend->name() == "Face" ? "Body" : "Face");
+  }
+  string modeName() const { return backend->name(); }
+  bool fixedInputSize() const { return backend->fixedInputSize(); }
+  double lastWaitMs() const { return backend->lastWaitMs(); }
+
+  vector<Rect> detect(InputArray img, double scale = 1.0) {
     if (useWindow) {
       // Verifica che la finestra sia all'interno dei limiti del frame
       Rect safeWindow = detectionWindow;
@@ -98,15 +630,7 @@ class Detector {
       } else {
         // Usa solo la regione specificata
         Mat roi = img.getMat()(safeWindow);
-        cvtColor(roi, gray, COLOR_BGR2GRAY);
-        equalizeHist(gray, gray);
-
-        if (m == Face && !face_cascade.empty()) {
-          face_cascade.detectMultiScale(gray, found, 1.1, 3, 0, Size(30, 30));
-        } else {
-          hog.detectMultiScale(roi, found, 0, Size(8, 8), Size(), 1.05, 2,
-                               false);
-        }
+        vector<Rect> found = detectScaled(roi, scale);
 
         /*for (auto& r : found) {
             r.x += safeWindow.x;
@@ -117,30 +641,10 @@ class Detector {
       }
     }
 
-    cvtColor(img, gray, COLOR_BGR2GRAY);
-    equalizeHist(gray, gray);
-
-    if (m == Face && !face_cascade.empty()) {
-      face_cascade.detectMultiScale(gray, found, 1.1, 3, 0, Size(30, 30));
-    } else {
-      hog.detectMultiScale(img, found, 0, Size(8, 8), Size(), 1.05, 2, false);
-    }
-    return found;
+    return detectScaled(img.getMat(), scale);
   }
 
-  void adjustRect(Rect &r) const {
-    if (m == Body) {
-      r.x += cvRound(r.width * 0.1);
-      r.width = cvRound(r.width * 0.8);
-      r.y += cvRound(r.height * 0.07);
-      r.height = cvRound(r.height * 0.8);
-    } else {
-      r.x -= cvRound(r.width * 0.1);
-      r.width = cvRound(r.width * 1.2);
-      r.y -= cvRound(r.height * 0.1);
-      r.height = cvRound(r.height * 1.2);
-    }
-  }
+  void adjustRect(Rect &r) const { backend->adjustRect(r); }
 };
 
 string generateRandomId(int length) {
@@ -157,23 +661,245 @@ string generateRandomId(int length) {
   return randomId;
 }
 
+// Canale di controllo verso il CameraManager, gestito sullo stesso io_service
+// del server WebSocket: connessione, comandi in ingresso e telemetria in
+// uscita sono tutte operazioni asincrone, senza thread dedicati.
+// Il CameraManager termina il nodo scrivendo 'k' sullo stdin del processo o
+// chiudendo la socket, quindi entrambi i casi invocano il kill handler.
+class ManagerConnection {
+  using tcp = boost::asio::ip::tcp;
+
+  static constexpr int maxAttempts = 5;
+  static constexpr int minBackoffMs = 1000;
+  static constexpr int maxBackoffMs = 8000;
+  static constexpr size_t maxOutbox = 1024;
+
+  boost::asio::io_service &ios;
+  tcp::socket socket;
+  boost::asio::steady_timer retryTimer;
+  boost::asio::posix::stream_descriptor input;
+  tcp::endpoint endpoint;
+  array<char, 1024> readBuffer;
+  array<char, 256> inputBuffer;
+  deque<string> outbox;
+  bool connected = false;
+  bool writing = false;
+  bool stopped = true;
+  int attempts = 0;
+  int backoffMs = minBackoffMs;
+  function<void()> onKill;
+
+  void kill() {
+    if (stopped) return;
+    stop();
+    if (onKill) onKill();
+  }
+
+  void scheduleConnect(int delayMs) {
+    retryTimer.expires_from_now(chrono::milliseconds(delayMs));
+    retryTimer.async_wait([this](const boost::system::error_code &ec) {
+      if (!ec && !stopped) connect();
+    });
+  }
+
+  void connect() {
+    attempts++;
+    cout << "Tentativo di connessione al CameraManager " << attempts << "/"
+         << maxAttempts << endl;
+
+    socket.async_connect(endpoint, [this](const boost::system::error_code &ec) {
+      if (stopped) return;
+      if (ec) {
+        cerr << "Connection attempt " << attempts
+             << " failed: " << ec.message() << endl;
+        boost::system::error_code ignored;
+        socket.close(ignored);
+        if (attempts >= maxAttempts) {
+          cerr << "Failed to connect to CameraManager after " << maxAttempts
+               << " attempts" << endl;
+          outbox.clear();
+          return;
+        }
+        int delay = backoffMs;
+        backoffMs = min(backoffMs * 2, maxBackoffMs);
+        scheduleConnect(delay);
+        return;
+      }
+
+      cout << "Successfully connected to CameraManager at " << endpoint
+           << endl;
+      connected = true;
+      boost::system::error_code ignored;
+      socket.set_option(tcp::no_delay(true), ignored);
+      read();
+      write();
+    });
+  }
+
+  // Il CameraManager chiude la socket quando ferma o riconfigura il nodo
+  void disconnected(const boost::system::error_code &ec) {
+    cout << "Disconnessione dal CameraManager rilevata (" << ec.message()
+         << "). Chiusura in corso..." << endl;
+    kill();
+  }
+
+  void read() {
+    socket.async_read_some(
+        boost::asio::buffer(readBuffer),
+        [this](const boost::system::error_code &ec, size_t bytesRead) {
+          if (stopped) return;
+          if (ec) {
+            disconnected(ec);
+            return;
+          }
+
+          // Verifica se è stato ricevuto il carattere 'k'
+          auto end = readBuffer.begin() + bytesRead;
+          if (find(readBuffer.begin(), end, 'k') != end) {
+            cout << "Ricevuto comando di terminazione 'k'. Chiusura in corso..."
+                 << endl;
+            kill();
+            return;
+          }
+          read();
+        });
+  }
+
+  void readInput() {
+    input.async_read_some(
+        boost::asio::buffer(inputBuffer),
+        [this](const boost::system::error_code &ec, size_t bytesRead) {
+          if (stopped) return;
+          // Senza stdin (es. avvio da run.sh) i comandi arrivano solo dalla
+          // socket
+          if (ec) return;
+
+          auto end = inputBuffer.begin() + bytesRead;
+          if (find(inputBuffer.begin(), end, 'k') != end) {
+            cout << "Ricevuto comando di terminazione 'k' su stdin. Chiusura "
+                    "in corso..."
+                 << endl;
+            kill();
+            return;
+          }
+          readInput();
+        });
+  }
+
+  void write() {
+    if (!connected || writing || outbox.empty()) return;
+    writing = true;
+    boost::asio::async_write(
+        socket, boost::asio::buffer(outbox.front()),
+        [this](const boost::system::error_code &ec, size_t) {
+          writing = false;
+          if (stopped) return;
+          if (ec) {
+            disconnected(ec);
+            return;
+          }
+          outbox.pop_front();
+          write();
+        });
+  }
+
+ public:
+  explicit ManagerConnection(boost::asio::io_service &service)
+      : ios(service), socket(service), retryTimer(service), input(service) {}
+
+  void setKillHandler(function<void()> handler) { onKill = move(handler); }
+
+  void start(const string &host, int port) {
+    ios.post([this, host, port] {
+      boost::system::error_code ec;
+      auto address = boost::asio::ip::address::from_string(host, ec);
+      if (ec) {
+        cerr << "Invalid CameraManager address: " << host << endl;
+        return;
+      }
+      endpoint = tcp::endpoint(address, port);
+      stopped = false;
+
+      // Lo stdin e' duplicato per non chiudere il descrittore 0 in uscita
+      int fd = dup(STDIN_FILENO);
+      if (fd >= 0) {
+        input.assign(fd, ec);
+        if (ec) {
+          cerr << "Cannot read commands from stdin: " << ec.message() << endl;
+          close(fd);
+        } else {
+          readInput();
+        }
+      }
+
+      // Ritarda leggermente la connessione per dare tempo al CameraManager di
+      // prepararsi
+      scheduleConnect(minBackoffMs);
+    });
+  }
+
+  // Thread-safe: la riga viene accodata ed inviata dal thread dell'io_service
+  void send(const string &line) {
+    ios.post([this, line] {
+      // Finche' non c'e' connessione accoda un numero limitato di eventi
+      if (outbox.size() >= maxOutbox) return;
+      outbox.push_back(line + "\n");
+      write();
+    });
+  }
+
+  // Da chiamare sul thread dell'io_service o dopo che questo e' terminato
+  void stop() {
+    stopped = true;
+    connected = false;
+    boost::system::error_code ignored;
+    retryTimer.cancel(ignored);
+    socket.close(ignored);
+    input.close(ignored);
+  }
+};
+
 class VideoServer {
   string cameraId;
   int windowX, windowY, windowWidth, windowHeight;
   bool useWindow;
+  EventConfig eventConfig;
+  string detectionMode;
+  shared_ptr<DnnBatcher> dnnBatcher;
+  PlacementConfig placement;
+  QosConfig qosConfig;
+  string eventTag;
 
  public:
-  VideoServer(int camera, string file, string id = "", int x = 0, int y = 0,
-              int width = 0, int height = 0)
-      : running(false),
+  // Piu' VideoServer possono condividere io_service, CameraManager e batcher
+  // DNN; con tagEvents gli eventi sono preceduti da "camera<id>:"
+  VideoServer(boost::asio::io_service &service, ManagerConnection &managerLink,
+              int camera, string file, string id = "", int x = 0, int y = 0,
+              int width = 0, int height = 0,
+              const EventConfig &events = EventConfig(),
+              const string &mode = "Face",
+              shared_ptr<DnnBatcher> batcher = nullptr,
+              const PlacementConfig &threads = PlacementConfig(),
+              const QosConfig &qos = QosConfig(), bool tagEvents = false)
+      : running(true),
+        stopping(false),
         windowX(x),
         windowY(y),
         windowWidth(width),
-        windowHeight(height) {
+        windowHeight(height),
+        eventConfig(events),
+        detectionMode(mode),
+        dnnBatcher(move(batcher)),
+        placement(threads),
+        qosConfig(qos),
+        ios(service),
+        manager(managerLink) {
     useWindow = (width > 0 && height > 0);
     cameraId = id.empty() ? generateRandomId(10) : id;
+    eventTag = tagEvents ? "camera" + cameraId + ":" : "";
 
-    server.init_asio();
+    // Il server WebSocket gira sull'io_service condiviso del processo
+    server.init_asio(&ios);
     server.set_access_channels(websocketpp::log::alevel::none);
     server.clear_access_channels(websocketpp::log::alevel::all);
 
@@ -220,6 +946,12 @@ class VideoServer {
 
   string getCameraId() const { return cameraId; }
 
+  bool isStopped() const { return stopping; }
+
+  // Invocato sul thread dell'io_service quando lo stream termina da solo
+  // (sorgente non apribile o camera scollegata), dopo stop()
+  void setStopHandler(function<void()> handler) { onStopped = move(handler); }
+
   bool isPortAvailable(uint16_t port) {
     using namespace websocketpp::lib::asio;
 
@@ -245,7 +977,8 @@ class VideoServer {
     }
   }
 
-  void run(uint16_t port) {
+  // Apre la porta; le connessioni sono servite da chi esegue l'io_service
+  void listen(uint16_t port) {
     int retry_count = 0;
     const int max_retries = 3;
 
@@ -265,9 +998,6 @@ class VideoServer {
         std::cout << "Server listening on port " << port << std::endl;
         server.start_accept();
         std::cout << "Server started accepting connections" << std::endl;
-
-        // Run the server
-        server.run();
         break;  // If successful, exit the loop
       } catch (const websocketpp::exception &e) {
         std::cerr << "WebSocket server error: " << e.what() << std::endl;
@@ -289,8 +1019,12 @@ class VideoServer {
     }
   }
 
+  // Idempotente; il thread video viene sempre atteso, anche se il segnale
+  // arriva prima che la cattura sia aperta
   void stop() {
-    if (running.exchange(false)) {
+    if (!stopping.exchange(true)) {
+      running = false;
+
       cout << "Stopping video processing thread..." << endl;
 
       if (videoThread.joinable()) {
@@ -301,13 +1035,12 @@ class VideoServer {
       // Chiudi tutte le connessioni
       closeAllConnections();
 
-      // Ferma il server WebSocket
+      // Smette di accettare connessioni; l'io_service condiviso viene
+      // fermato da chi lo esegue
       try {
         cout << "Stopping WebSocket server..." << endl;
         server.stop_listening();
-        server.stop();
         cout << "WebSocket server stopped successfully" << endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
       } catch (const std::exception &e) {
         cerr << "Error stopping WebSocket server: " << e.what() << endl;
       }
@@ -351,7 +1084,22 @@ class VideoServer {
          << endl;
   }
 
+  // Ferma solo questo server: gli altri stream del processo continuano. Il
+  // join del thread video avviene sul thread dell'io_service
+  void finish() {
+    ios.post([this] {
+      if (isStopped()) return;
+      stop();
+      if (onStopped) onStopped();
+    });
+  }
+
   void processVideo(int camera, string file) {
+    applyThreadPlacement("video", placement.videoCpus, placement.fifoPriority);
+    // Senza --cpudetect ne' batcher DNN il pool di OpenCV segue il thread
+    // video
+    placeOpenCvPool("video");
+
     VideoCapture cap;
     if (file.empty())
       cap.open(camera);
@@ -363,7 +1111,8 @@ class VideoServer {
     if (!cap.isOpened()) {
       cerr << "Cannot open video stream: '"
            << (file.empty() ? "<camera>" : file) << "'" << endl;
-      exit(1);
+      finish();
+      return;
     } else {
       cout << "Server started successfully" << endl;
       cout.flush();
@@ -375,35 +1124,55 @@ class VideoServer {
     cout << "Press Ctrl+C to quit." << endl;
     cout << "Streaming on WebSocket..." << endl;
 
-    Detector detector(windowX, windowY, windowWidth, windowHeight);
+    Detector detector(windowX, windowY, windowWidth, windowHeight,
+                      detectionMode, dnnBatcher);
+    DetectionEvents events(eventConfig);
+    QosController qos(qosConfig, delay, detector.fixedInputSize());
+    vector<Rect> found;
+    double detectFps = 0;
+    long frameIndex = 0;
     Mat frame;
-    running = true;
 
     while (running) {
+      auto frameStart = chrono::steady_clock::now();
       cap >> frame;
       if (frame.empty()) {
         if (!file.empty()) {
           cap.set(CAP_PROP_POS_FRAMES, 0);
           continue;
         }
+        finish();
         break;
       }
 
-      int64 t = getTickCount();
-      vector<Rect> found = detector.detect(frame);
-      t = getTickCount() - t;
-
-      double fps = getTickFrequency() / (double)t;
+      // La QoS misura solo l'elaborazione: l'attesa della camera in cap >>
+      // non consuma il budget
+      auto workStart = chrono::steady_clock::now();
+
+      // Sotto carico la detection gira ridotta e non su ogni frame; negli
+      // altri frame si riusano gli ultimi box trovati
+      const QosLevel &level = qos.current();
+      bool detected = frameIndex++ % level.stride == 0;
+      double waitMs = 0;
+      if (detected) {
+        int64 t = getTickCount();
+        found = detector.detect(frame, level.detectScale);
+        t = getTickCount() - t;
+
+        detectFps = getTickFrequency() / (double)t;
+        waitMs = detector.lastWaitMs();
+      }
 
-      // Invia i dati al CameraManager se connesso
-      if (manager_socket >= 0) {
-        std::string dataToSend = std::to_string(found.size()) + ":" +
-                                 detector.modeName() + ":" +
-                                 std::to_string(fps) + "\n";
-        send(manager_socket, dataToSend.c_str(), dataToSend.length(), 0);
+      // Aggiornato ad ogni frame: hit e count avanzano solo con una nuova
+      // detection, miss e heartbeat ad ogni frame.
+      // Invia al CameraManager solo i cambiamenti significativi
+      for (const auto &event :
+           events.update(found, detector.modeName(), detectFps,
+                         qos.levelIndex(), detected)) {
+        manager.send(eventTag + event);
       }
 
-      for (auto &r : found) {
+      for (Rect r : found) {
         detector.adjustRect(r);
         if (useWindow) {
           // Se usiamo la finestra, aggiungi l'offset per la visualizzazione
@@ -419,59 +1188,53 @@ class VideoServer {
       }
 
       Mat resized;
-      resize(frame, resized, Size(), 0.5, 0.5);
+      resize(frame, resized, Size(), level.outputScale, level.outputScale);
       vector<uchar> buffer;
-      vector<int> params = {IMWRITE_JPEG_QUALITY, 60};
+      vector<int> params = {IMWRITE_JPEG_QUALITY, level.jpegQuality};
       imencode(".jpg", resized, buffer, params);
 
-      lock_guard<mutex> lock(connectionsMutex);
-      for (auto &hdl : connections) {
-        try {
-          server.send(hdl, buffer.data(), buffer.size(),
-                      websocketpp::frame::opcode::binary);
-        } catch (const websocketpp::exception &e) {
-          cerr << "Send error: " << e.what() << endl;
+      {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (auto &hdl : connections) {
+          try {
+            server.send(hdl, buffer.data(), buffer.size(),
+                        websocketpp::frame::opcode::binary);
+          } catch (const websocketpp::exception &e) {
+            cerr << "Send error: " << e.what() << endl;
+          }
         }
       }
 
-      this_thread::sleep_for(chrono::milliseconds(delay));
+      auto now = chrono::steady_clock::now();
+      chrono::duration<double, milli> work = now - workStart;
+      chrono::duration<double, milli> elapsed = now - frameStart;
+      // Nemmeno l'attesa nella coda del batcher DNN, che dipende da --wait e
+      // dagli altri stream
+      if (qos.update(work.count() - waitMs)) {
+        cout << "QoS level changed: " << qos.describe() << endl;
+        manager.send(eventTag + qos.describe());
+      }
+
+      // Attende solo il tempo rimanente del frame, cosi' il ritardo non si
+      // accumula
+      this_thread::sleep_for(chrono::milliseconds(delay) - elapsed);
     }
 
     cout << "Video capture loop terminated" << endl;
     cap.release();
   }
 
+  boost::asio::io_service &ios;
+  ManagerConnection &manager;
   Server server;
   set<connection_hdl, owner_less<connection_hdl>> connections;
   mutex connectionsMutex;
   thread videoThread;
+  function<void()> onStopped;
   atomic<bool> running;
+  atomic<bool> stopping;
 };
 
-// Funzione di gestione del segnale per la chiusura pulita
-VideoServer *globalServerPtr = nullptr;
-
-void signalHandler(int signal) {
-  cout << "Signal " << signal << " received. Shutting down immediately..."
-       << endl;
-
-  // Chiudi la socket del manager se aperta
-  if (manager_socket >= 0) {
-    close(manager_socket);
-    manager_socket = -1;
-  }
-
-  if (globalServerPtr) {
-    globalServerPtr->stop();
-  }
-
-  // Short delay to allow resources to be released
-  std::this_thread::sleep_for(std::chrono::seconds(1));
-
-  // Termina immediatamente
-  _exit(0);
-}
-
 bool isPortAvailable(uint16_t port) {
   using namespace websocketpp::lib::asio;
 
@@ -497,130 +1260,22 @@ bool isPortAvailable(uint16_t port) {
   }
 }
 
-void managerSocketListener() {
-  if (manager_socket < 0) {
-    return;
+// Divide un'opzione con piu' valori separati da virgola, uno per stream
+vector<string> splitList(const string &value) {
+  vector<string> items;
+  stringstream ss(value);
+  string item;
+  while (getline(ss, item, ',')) {
+    if (!item.empty()) items.push_back(item);
   }
-
-  char buffer[1024];
-  while (true) {
-    // Preparazione per select()
-    fd_set readSet;
-    FD_ZERO(&readSet);
-    FD_SET(manager_socket, &readSet);
-
-    // Timeout di 0.5 secondi
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 500000;  // 500ms
-
-    // Utilizzo di select per attendere dati senza bloccare
-    int activity = select(manager_socket + 1, &readSet, NULL, NULL, &timeout);
-
-    if (activity < 0) {
-      cout << "Errore nella funzione select(): " << strerror(errno) << endl;
-      break;
-    }
-
-    // Verifica se ci sono dati da leggere
-    if (activity > 0 && FD_ISSET(manager_socket, &readSet)) {
-      memset(buffer, 0, sizeof(buffer));
-      int bytesRead = recv(manager_socket, buffer, sizeof(buffer) - 1, 0);
-
-      if (bytesRead <= 0) {
-        // Connessione chiusa o errore
-        cout << "Connessione con CameraManager interrotta." << endl;
-        break;
-      }
-
-      // Verifica se è stato ricevuto il carattere 'k'
-      for (int i = 0; i < bytesRead; i++) {
-        if (buffer[i] == 'k') {
-          cout << "Ricevuto comando di terminazione 'k'. Chiusura forzata in "
-                  "corso..."
-               << endl;
-
-          // Chiudi la socket se non è già stata chiusa
-          if (manager_socket >= 0) {
-            close(manager_socket);
-            manager_socket = -1;
-          }
-
-          // Termina immediatamente il processo con _exit (bypassa tutti i
-          // cleanup)
-          _exit(0);
-        }
-      }
-    }
-  }
-
-  cout << "Disconnessione dal CameraManager rilevata. Chiusura in corso..."
-       << endl;
-
-  if (manager_socket >= 0) {
-    close(manager_socket);
-    manager_socket = -1;
-  }
-
-  std::this_thread::sleep_for(std::chrono::seconds(3));
-
-  _exit(0);
+  return items;
 }
 
-// Funzione per connettersi al CameraManager con tentativi multipli
-bool connectToCameraManager(const std::string &host, int port) {
-  const int MAX_ATTEMPTS = 5;
-  int attempts = 0;
-
-  while (attempts < MAX_ATTEMPTS) {
-    std::cout << "Tentativo di connessione al CameraManager " << (attempts + 1)
-              << "/" << MAX_ATTEMPTS << std::endl;
-
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) {
-      std::cerr << "Socket creation failed" << std::endl;
-      attempts++;
-      std::this_thread::sleep_for(std::chrono::seconds(2));
-      continue;
-    }
-
-    struct sockaddr_in serv_addr;
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, host.c_str(), &serv_addr.sin_addr) <= 0) {
-      std::cerr << "Invalid address / Address not supported" << std::endl;
-      close(sock);
-      attempts++;
-      std::this_thread::sleep_for(std::chrono::seconds(2));
-      continue;
-    }
-
-    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-      std::cerr << "Connection attempt " << (attempts + 1)
-                << " failed: " << strerror(errno) << std::endl;
-      close(sock);
-      attempts++;
-      std::this_thread::sleep_for(std::chrono::seconds(2));
-      continue;
-    }
-
-    std::cout << "Successfully connected to CameraManager at " << host << ":"
-              << port << std::endl;
-
-    // Memorizza il socket per l'uso successivo
-    manager_socket = sock;
-
-    // Avvia un thread per monitorare i dati in arrivo dalla socket
-    std::thread listenerThread(managerSocketListener);
-    listenerThread.detach();
-
-    return true;
-  }
-
-  std::cerr << "Failed to connect to CameraManager after " << MAX_ATTEMPTS
-            << " attempts" << std::endl;
-  return false;
+// Valore per lo stream i: se la lista e' piu' corta si ripete l'ultimo
+string listValue(const vector<string> &values, size_t i,
+                 const string &fallback = "") {
+  if (values.empty()) return fallback;
+  return values[min(i, values.size() - 1)];
 }
 
 // Use example of x, y, h and w parameters: --x=320 --y=180 --width=600
@@ -629,27 +1284,51 @@ int main(int argc, char **argv) {
   CommandLineParser parser(
       argc, argv,
       "{ help h   |   | print help message }"
-      "{ camera c | 0 | capture video from camera (device index starting from "
-      "0) }"
-      "{ video v  |   | use video as input }"
-      "{ port p   | 5555 | WebSocket server port }"
-      "{ id      |   | camera identifier for the stream endpoint }"
+      "{ camera c | 0 | capture video from cameras (device indexes starting "
+      "from 0, comma separated) }"
+      "{ video v  |   | use videos as input (comma separated) }"
+      "{ port p   | 5555 | WebSocket port of the first stream, then +1 each }"
+      "{ id      |   | camera identifiers for the stream endpoints }"
       "{ x       | 0 | x coordinate of detection window }"
       "{ y       | 0 | y coordinate of detection window }"
       "{ width w | 0 | width of detection window (0 for full frame) }"
-      "{ height h| 0 | height of detection window (0 for full frame) }");
-
-  parser.about("Face/Body detection with WebSocket streaming capability");
+      "{ height h| 0 | height of detection window (0 for full frame) }"
+      "{ hysteresis | 3 | detections a change must persist to be reported }"
+      "{ lost     | 5 | missed frames before a tracked object is lost }"
+      "{ iou      | 0.3 | minimum overlap to match a detection to a track }"
+      "{ heartbeat | 30 | seconds between heartbeats (0 disables) }"
+      "{ mode m   | Face | detector per stream: Face, Body or Dnn }"
+      "{ model    |   | SSD or YOLO model (ONNX, Caffe, TF) for the Dnn mode }"
+      "{ dnnconfig |  | network config of Caffe or TensorFlow models }"
+      "{ dnnsize  | 320 | input size of the Dnn model }"
+      "{ batch    | 4 | max frames per Dnn forward pass }"
+      "{ wait     | 10 | max milliseconds to wait for a full Dnn batch }"
+      "{ conf     | 0.5 | Dnn confidence threshold }"
+      "{ class    | 0 | Dnn class id to keep (-1 for all) }"
+      "{ cpuvideo |   | cores for capture, detection, encoding (e.g. 0-3,8) }"
+      "{ cpudetect |  | cores for the Dnn worker and OpenCV's thread pool }"
+      "{ cpunet   |   | cores for the WebSocket/CameraManager thread }"
+      "{ cvthreads | -1 | OpenCV threads shared by all streams (-1 default) }"
+      "{ fifo     | 0 | SCHED_FIFO priority of pipeline threads (0 disables) }"
+      "{ nice     | 0 | nice level of the process }"
+      "{ qos      | 1 | adapt detection and stream quality to the budget }"
+      "{ budget   | 0 | frame budget in ms for QoS (0 = from source fps) }");
+
+  parser.about("Face/Body/DNN detection with WebSocket streaming capability");
 
   if (parser.has("help")) {
     parser.printMessage();
     return 0;
   }
 
-  int camera = parser.get<int>("camera");
-  string file = parser.get<string>("video");
+  // Uno stream per ogni video, altrimenti per ogni camera. Il CameraManager
+  // avvia un processo per camera: piu' stream nello stesso processo servono
+  // ai nodi avviati a mano (es. run.sh), i cui eventi sono preceduti da
+  // "camera<id>:", e un 'k' li ferma tutti
+  vector<string> cameras = splitList(parser.get<string>("camera"));
+  vector<string> files = splitList(parser.get<string>("video"));
+  vector<string> cameraIds = splitList(parser.get<string>("id"));
   int port = parser.get<int>("port");
-  string cameraId = parser.get<string>("id");
 
   // Parametri opzionali della finestra
   int x = parser.get<int>("x");
@@ -657,63 +1336,191 @@ int main(int argc, char **argv) {
   int width = parser.get<int>("width");
   int height = parser.get<int>("height");
 
+  // Parametri degli eventi inviati al CameraManager
+  EventConfig events;
+  events.hysteresis = max(1, parser.get<int>("hysteresis"));
+  events.lostAfter = max(1, parser.get<int>("lost"));
+  events.iouThreshold = parser.get<double>("iou");
+  events.heartbeat = parser.get<double>("heartbeat");
+
+  // Parametri del detector
+  vector<string> modes = splitList(parser.get<string>("mode"));
+  DnnConfig dnnConfig;
+  dnnConfig.model = parser.get<string>("model");
+  dnnConfig.config = parser.get<string>("dnnconfig");
+  dnnConfig.inputSize = parser.get<int>("dnnsize");
+  dnnConfig.batchSize = max(1, parser.get<int>("batch"));
+  dnnConfig.maxWaitMs = max(0, parser.get<int>("wait"));
+  dnnConfig.confThreshold = parser.get<float>("conf");
+  dnnConfig.classId = parser.get<int>("class");
+
+  // Posizionamento dei thread
+  PlacementConfig placement;
+  placement.videoCpus = parser.get<string>("cpuvideo");
+  placement.detectCpus = parser.get<string>("cpudetect");
+  placement.networkCpus = parser.get<string>("cpunet");
+  placement.cvThreads = parser.get<int>("cvthreads");
+  placement.fifoPriority = parser.get<int>("fifo");
+  placement.niceLevel = parser.get<int>("nice");
+
+  // Controllo adattivo della qualita'
+  QosConfig qos;
+  qos.enabled = parser.get<int>("qos") != 0;
+  qos.budgetMs = parser.get<double>("budget");
+
   if (!parser.check()) {
     parser.printErrors();
     return 1;
   }
 
+  size_t streams = files.empty() ? cameras.size() : files.size();
+  vector<int> cameraIndexes;
+  for (const auto &camera : cameras) {
+    try {
+      cameraIndexes.push_back(stoi(camera));
+    } catch (const exception &) {
+      cerr << "Invalid camera index: " << camera << endl;
+      return 1;
+    }
+  }
+  if (streams == 0) {
+    cerr << "No camera or video to stream" << endl;
+    return 1;
+  }
+
+  if (events.iouThreshold <= 0 || events.iouThreshold > 1) {
+    cerr << "Invalid --iou: must be in (0, 1]" << endl;
+    return 1;
+  }
+  if (events.heartbeat < 0) {
+    cerr << "Invalid --heartbeat: must be >= 0" << endl;
+    return 1;
+  }
+  if (dnnConfig.inputSize <= 0) {
+    cerr << "Invalid --dnnsize: must be > 0" << endl;
+    return 1;
+  }
+
+  for (const auto &spec : {placement.videoCpus, placement.detectCpus,
+                           placement.networkCpus}) {
+    cpu_set_t cpus;
+    if (!spec.empty() && !parseCpuList(spec, cpus)) {
+      cerr << "Invalid CPU list: " << spec << endl;
+      return 1;
+    }
+  }
+
+  // Applicati prima di creare i thread, che li ereditano
+  if (placement.niceLevel != 0 &&
+      setpriority(PRIO_PROCESS, 0, placement.niceLevel) != 0) {
+    cerr << "Cannot set nice level " << placement.niceLevel << ": "
+         << strerror(errno) << endl;
+  }
+  if (placement.cvThreads >= 0) {
+    setNumThreads(placement.cvThreads);
+  }
+  cout << "OpenCV threads: " << getNumThreads() << endl;
+
+  // Anche detectMultiScale di Face e Body usa il pool di OpenCV: con
+  // --cpudetect lo crea subito un thread gia' su quei core, prima che un
+  // thread video lo faccia con --cpuvideo
+  if (!placement.detectCpus.empty()) {
+    thread([&placement] {
+      applyThreadPlacement("detect", placement.detectCpus,
+                           placement.fifoPriority);
+      placeOpenCvPool("detect");
+    }).join();
+  }
+
   try {
-    // Check if port is available before creating the server
-    if (!isPortAvailable(port)) {
-      // Se abbiamo l'opzione SO_REUSEADDR, possiamo continuare anche se la
-      // porta sembra in uso
-      cerr << "Warning: Port " << port
-           << " might still be in TIME_WAIT state, trying to reuse it..."
-           << endl;
-      // Continuiamo comunque, dato che abbiamo impostato SO_REUSEADDR nel
-      // server
+    for (size_t i = 0; i < streams; i++) {
+      // Check if port is available before creating the server
+      if (!isPortAvailable(port + i)) {
+        // Se abbiamo l'opzione SO_REUSEADDR, possiamo continuare anche se la
+        // porta sembra in uso
+        cerr << "Warning: Port " << port + i
+             << " might still be in TIME_WAIT state, trying to reuse it..."
+             << endl;
+        // Continuiamo comunque, dato che abbiamo impostato SO_REUSEADDR nel
+        // server
+      }
     }
 
-    // Connetti al CameraManager
-    std::string managerHost = "127.0.0.1";
-    int managerPort = 8080;
-    std::thread connectionThread([managerHost, managerPort]() {
-      // Ritarda leggermente la connessione per dare tempo al CameraManager di
-      // prepararsi
-      std::this_thread::sleep_for(std::chrono::seconds(1));
-      connectToCameraManager(managerHost, managerPort);
-    });
-    connectionThread.detach();
+    // Server WebSocket, CameraManager e segnali condividono lo stesso
+    // io_service, eseguito dal thread principale
+    boost::asio::io_service ios;
+    ManagerConnection manager(ios);
+    boost::asio::signal_set signals(ios, SIGINT, SIGTERM);
+
+    // Il batcher e' condiviso da tutti gli stream del processo, cosi' i frame
+    // di piu' camere finiscono nello stesso forward pass
+    shared_ptr<DnnBatcher> batcher;
+    for (size_t i = 0; i < streams; i++) {
+      if (listValue(modes, i, "Face") == "Dnn" && !batcher) {
+        batcher = make_shared<DnnBatcher>(dnnConfig, placement);
+      }
+    }
 
-    unique_ptr<VideoServer> server =
-        make_unique<VideoServer>(camera, file, cameraId, x, y, width, height);
+    vector<unique_ptr<VideoServer>> servers;
+    for (size_t i = 0; i < streams; i++) {
+      int camera = files.empty() ? cameraIndexes[i] : 0;
+      string file = files.empty() ? "" : files[i];
+      string cameraId = i < cameraIds.size() ? cameraIds[i] : "";
+      servers.push_back(make_unique<VideoServer>(
+          ios, manager, camera, file, cameraId, x, y, width, height, events,
+          listValue(modes, i, "Face"), batcher, placement, qos, streams > 1));
+    }
 
-    // Registra il gestore di segnali per la chiusura pulita
-    globalServerPtr = server.get();
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
+    // Eseguito sul thread dell'io_service: ferma tutto e fa terminare run()
+    auto shutdown = [&]() {
+      for (auto &server : servers) server->stop();
+      manager.stop();
+      boost::system::error_code ignored;
+      signals.cancel(ignored);
+      ios.stop();
+    };
+    manager.setKillHandler(shutdown);
+
+    // Uno stream che termina ferma solo il proprio server; il processo esce
+    // quando non ne resta nessuno
+    bool streamsEnded = false;
+    for (auto &server : servers) {
+      server->setStopHandler([&]() {
+        for (auto &other : servers) {
+          if (!other->isStopped()) return;
+        }
+        cerr << "No stream left running. Shutting down..." << endl;
+        streamsEnded = true;
+        shutdown();
+      });
+    }
+    signals.async_wait([&](const boost::system::error_code &ec, int signal) {
+      if (ec) return;
+      cout << "Signal " << signal << " received. Shutting down..." << endl;
+      shutdown();
+    });
 
-    cout << "Video server started on port " << port << endl;
-    cout << "Stream available at: /camera" << server->getCameraId() << endl;
+    for (size_t i = 0; i < streams; i++) {
+      servers[i]->listen(port + i);
+      cout << "Video server started on port " << port + i << endl;
+      cout << "Stream available at: /camera" << servers[i]->getCameraId()
+           << endl;
+    }
     if (width > 0 && height > 0) {
       cout << "Using detection window: x=" << x << ", y=" << y
            << ", width=" << width << ", height=" << height << endl;
     }
 
-    try {
-      // Run the server
-      server->run(port);
-    } catch (const websocketpp::exception &e) {
-      cerr << "WebSocket server error during run: " << e.what() << endl;
-      // Assicuriamoci di terminare completamente anche in caso di errore
-      if (globalServerPtr) {
-        globalServerPtr->stop();
-      }
-      return 1;
-    }
+    // Connetti al CameraManager
+    std::string managerHost = "127.0.0.1";
+    int managerPort = 8080;
+    manager.start(managerHost, managerPort);
 
-    // Dopo run(), il server è stato fermato, rilascia il puntatore globale
-    globalServerPtr = nullptr;
+    // Il thread principale diventa il thread di rete dell'io_service
+    applyThreadPlacement("network", placement.networkCpus,
+                         placement.fifoPriority);
+    ios.run();
+    if (streamsEnded) return 1;
   } catch (const websocketpp::exception &e) {
     cerr << "WebSocket server error: " << e.what() << endl;
     return 1;
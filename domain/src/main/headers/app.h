@@ -5,13 +5,337 @@
 #ifndef APP_H
 #define APP_H
 
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <opencv2/core.hpp>
+#include <sstream>
 #include <string>
+#include <vector>
 
 namespace DCCV {
 class Greeter {
  public:
   std::string greeting();
 };
+
+// Parses a core list such as "0-3,8" into a cpu_set_t.
+inline bool parseCpuList(const std::string &spec, cpu_set_t &cpus) {
+  CPU_ZERO(&cpus);
+  std::stringstream ss(spec);
+  std::string item;
+  int count = 0;
+
+  while (std::getline(ss, item, ',')) {
+    if (item.empty()) continue;
+    size_t dash = item.find('-');
+    try {
+      int first = std::stoi(item.substr(0, dash));
+      int last = dash == std::string::npos ? first
+                                           : std::stoi(item.substr(dash + 1));
+      if (first < 0 || last < first || last >= CPU_SETSIZE) return false;
+      for (int cpu = first; cpu <= last; cpu++, count++) CPU_SET(cpu, &cpus);
+    } catch (const std::exception &) {
+      return false;
+    }
+  }
+  return count > 0;
+}
+
+inline std::string formatCpuSet(const cpu_set_t &cpus) {
+  std::string result;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (!CPU_ISSET(cpu, &cpus)) continue;
+    int last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus)) last++;
+    if (!result.empty()) result += ",";
+    result += std::to_string(cpu);
+    if (last > cpu) result += "-" + std::to_string(last);
+    cpu = last;
+  }
+  return result;
+}
+
+// Parametri che regolano quando un cambiamento viene considerato significativo
+struct EventConfig {
+  int hysteresis = 3;         // detection consecutive prima di notificarle
+  int lostAfter = 5;          // frame senza match prima di perdere una traccia
+  double iouThreshold = 0.3;  // sovrapposizione minima per associare un box
+  double heartbeat = 30.0;    // secondi tra due heartbeat (0 = disabilitato)
+};
+
+// Converts the per-frame detections into a change-driven event stream.
+// Emitted lines:
+//   count:mode:fps                        stable count transition
+//   track:new:id:x,y,w,h                  object confirmed with a stable id
+//   track:lost:id:hits                    object not seen for lostAfter frames
+//   heartbeat:mode:frames:avg:max:fps:qos aggregated stats over the window
+class DetectionEvents {
+  struct Track {
+    int id;
+    cv::Rect box;
+    int hits;
+    int misses;
+    bool confirmed;
+  };
+
+  EventConfig cfg;
+  std::vector<Track> tracks;
+  int nextId = 1;
+
+  int reportedCount = -1;
+  std::string reportedMode;
+  int candidateCount = -1;
+  int candidateFrames = 0;
+
+  std::chrono::steady_clock::time_point windowStart =
+      std::chrono::steady_clock::now();
+  long windowFrames = 0;
+  long windowCountSum = 0;
+  int windowMaxCount = 0;
+  double windowFpsSum = 0;
+
+  static double iou(const cv::Rect &a, const cv::Rect &b) {
+    double inter = (a & b).area();
+    double uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0;
+  }
+
+  static std::string formatRect(const cv::Rect &r) {
+    return std::to_string(r.x) + "," + std::to_string(r.y) + "," +
+           std::to_string(r.width) + "," + std::to_string(r.height);
+  }
+
+  void updateTracks(const std::vector<cv::Rect> &found,
+                    std::vector<std::string> &events) {
+    std::vector<bool> used(found.size(), false);
+
+    for (auto &t : tracks) {
+      int best = -1;
+      double bestIou = cfg.iouThreshold;
+      for (size_t i = 0; i < found.size(); i++) {
+        if (used[i]) continue;
+        double v = iou(t.box, found[i]);
+        if (v >= bestIou) {
+          bestIou = v;
+          best = (int)i;
+        }
+      }
+
+      if (best >= 0) {
+        used[best] = true;
+        t.box = found[best];
+        t.hits++;
+        t.misses = 0;
+        if (!t.confirmed && t.hits >= cfg.hysteresis) {
+          t.confirmed = true;
+          events.push_back("track:new:" + std::to_string(t.id) + ":" +
+                           formatRect(t.box));
+        }
+      } else {
+        t.misses++;
+      }
+    }
+
+    dropLostTracks(events);
+
+    for (size_t i = 0; i < found.size(); i++) {
+      if (used[i]) continue;
+      Track t{nextId++, found[i], 1, 0, false};
+      if (cfg.hysteresis <= 1) {
+        t.confirmed = true;
+        events.push_back("track:new:" + std::to_string(t.id) + ":" +
+                         formatRect(t.box));
+      }
+      tracks.push_back(t);
+    }
+  }
+
+  // Nei frame senza detection una traccia gia' mancata resta mancata: le
+  // miss avanzano per frame, cosi' --lost non dipende dallo stride
+  void ageTracks(std::vector<std::string> &events) {
+    for (auto &t : tracks) {
+      if (t.misses > 0) t.misses++;
+    }
+    dropLostTracks(events);
+  }
+
+  void dropLostTracks(std::vector<std::string> &events) {
+    for (auto it = tracks.begin(); it != tracks.end();) {
+      if (it->misses >= cfg.lostAfter) {
+        if (it->confirmed) {
+          events.push_back("track:lost:" + std::to_string(it->id) + ":" +
+                           std::to_string(it->hits));
+        }
+        it = tracks.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void updateCount(int count, const std::string &mode, double fps,
+                   std::vector<std::string> &events) {
+    if (count == candidateCount) {
+      candidateFrames++;
+    } else {
+      candidateCount = count;
+      candidateFrames = 1;
+    }
+
+    bool countChanged = candidateCount != reportedCount &&
+                        candidateFrames >= std::max(1, cfg.hysteresis);
+    bool modeChanged = reportedCount >= 0 && mode != reportedMode;
+    if (countChanged || modeChanged) {
+      if (countChanged) reportedCount = candidateCount;
+      reportedMode = mode;
+      events.push_back(std::to_string(reportedCount) + ":" + mode + ":" +
+                       std::to_string(fps));
+    }
+  }
+
+  void updateHeartbeat(int count, const std::string &mode, double fps, int qos,
+                       std::vector<std::string> &events) {
+    windowFrames++;
+    windowCountSum += count;
+    windowMaxCount = std::max(windowMaxCount, count);
+    windowFpsSum += fps;
+
+    if (cfg.heartbeat <= 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - windowStart).count();
+    if (elapsed < cfg.heartbeat) return;
+
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2) << "heartbeat:" << mode << ":"
+         << windowFrames << ":" << (double)windowCountSum / windowFrames << ":"
+         << windowMaxCount << ":" << windowFpsSum / windowFrames << ":"
+         << qos;
+    events.push_back(line.str());
+
+    windowStart = now;
+    windowFrames = 0;
+    windowCountSum = 0;
+    windowMaxCount = 0;
+    windowFpsSum = 0;
+  }
+
+ public:
+  explicit DetectionEvents(const EventConfig &config = EventConfig())
+      : cfg(config) {}
+
+  // Restituisce gli eventi da inoltrare al CameraManager per questo frame.
+  // Con detected == false found sono i box riusati da una detection
+  // precedente: non contano come nuove conferme per hit e count, mentre miss
+  // e heartbeat avanzano comunque di un frame
+  std::vector<std::string> update(const std::vector<cv::Rect> &found,
+                                  const std::string &mode, double fps,
+                                  int qos = 0, bool detected = true) {
+    std::vector<std::string> events;
+    int count = (int)found.size();
+    if (detected) {
+      updateTracks(found, events);
+      updateCount(count, mode, fps, events);
+    } else {
+      ageTracks(events);
+    }
+    updateHeartbeat(count, mode, fps, qos, events);
+    return events;
+  }
+};
+
+// Parametri della pipeline per ciascun livello di qualita' del servizio
+struct QosLevel {
+  double detectScale;  // scala del frame passato al detector
+  int stride;          // detection una volta ogni stride frame
+  double outputScale;  // scala del frame inviato ai client
+  int jpegQuality;
+};
+
+struct QosConfig {
+  bool enabled = true;
+  double budgetMs = 0;  // budget per frame (0 = ricavato dagli fps sorgente)
+};
+
+// Compares the smoothed per-frame processing time against the frame budget,
+// stepping down one level after sustained overruns and back up only after a
+// longer stretch of headroom, so the stream does not oscillate.
+class QosController {
+  static constexpr double alpha = 0.2;      // smoothing della media mobile
+  static constexpr double highWater = 0.9;  // oltre questa frazione degrada
+  static constexpr double lowWater = 0.5;   // sotto questa frazione risale
+  static constexpr int downFrames = 15;
+  static constexpr int upFrames = 90;
+
+  // Il livello 0 corrisponde alla pipeline a piena qualita'
+  static const std::vector<QosLevel> &levelsFor(bool fixedInput) {
+    static const std::vector<QosLevel> scaled = {{1.0, 1, 0.5, 60},
+                                                 {0.75, 1, 0.5, 50},
+                                                 {0.5, 2, 0.4, 45},
+                                                 {0.5, 3, 0.35, 40},
+                                                 {0.35, 4, 0.25, 30}};
+    // Con input a dimensione fissa (Dnn) ridurre il frame non riduce il
+    // forward pass: ogni livello allunga invece lo stride
+    static const std::vector<QosLevel> strided = {{1.0, 1, 0.5, 60},
+                                                  {1.0, 2, 0.5, 50},
+                                                  {1.0, 3, 0.4, 45},
+                                                  {1.0, 4, 0.35, 40},
+                                                  {1.0, 6, 0.25, 30}};
+    return fixedInput ? strided : scaled;
+  }
+
+  const std::vector<QosLevel> &levels;
+  QosConfig cfg;
+  double budgetMs;
+  double avgMs = 0;
+  int level = 0;
+  int overFrames = 0;
+  int underFrames = 0;
+
+ public:
+  QosController(const QosConfig &config, double sourceBudgetMs,
+                bool fixedInputDetector = false)
+      : levels(levelsFor(fixedInputDetector)),
+        cfg(config),
+        budgetMs(config.budgetMs > 0 ? config.budgetMs : sourceBudgetMs) {}
+
+  const QosLevel &current() const { return levels[level]; }
+  int levelIndex() const { return level; }
+
+  // Registra il tempo di un frame; restituisce true se il livello cambia
+  bool update(double frameMs) {
+    avgMs = avgMs == 0 ? frameMs : alpha * frameMs + (1 - alpha) * avgMs;
+    if (!cfg.enabled || budgetMs <= 0) return false;
+
+    overFrames = avgMs > budgetMs * highWater ? overFrames + 1 : 0;
+    underFrames = avgMs < budgetMs * lowWater ? underFrames + 1 : 0;
+
+    int next = level;
+    if (overFrames >= downFrames && level + 1 < (int)levels.size()) {
+      next = level + 1;
+    } else if (underFrames >= upFrames && level > 0) {
+      next = level - 1;
+    }
+    if (next == level) return false;
+
+    level = next;
+    overFrames = 0;
+    underFrames = 0;
+    return true;
+  }
+
+  // Evento per il CameraManager: qos:level:avgMs:budgetMs
+  std::string describe() const {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(2) << "qos:" << level << ":"
+         << avgMs << ":" << budgetMs;
+    return line.str();
+  }
+};
+
 }  // namespace DCCV
 
 #endif
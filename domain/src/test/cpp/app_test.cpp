@@ -5,5 +5,178 @@
 #include "app.h"
 
 #include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
-int main() { return 0; }
+using namespace DCCV;
+using cv::Rect;
+using std::string;
+using std::vector;
+
+static EventConfig eventConfig(int hysteresis, int lostAfter) {
+  EventConfig config;
+  config.hysteresis = hysteresis;
+  config.lostAfter = lostAfter;
+  config.heartbeat = 0;
+  return config;
+}
+
+static bool contains(const vector<string> &events, const string &line) {
+  for (const auto &event : events) {
+    if (event == line) return true;
+  }
+  return false;
+}
+
+// Un count viene notificato solo dopo hysteresis detection consecutive
+static void testHysteresis() {
+  DetectionEvents events(eventConfig(3, 5));
+  vector<Rect> one = {Rect(10, 10, 20, 20)};
+  vector<Rect> none;
+
+  assert(events.update(one, "Face", 10).empty());
+  assert(events.update(none, "Face", 10).empty());
+  assert(events.update(one, "Face", 10).empty());
+
+  // La traccia conta le detection con match, il count quelle consecutive
+  vector<string> lines = events.update(one, "Face", 10);
+  assert(lines.size() == 1 && lines[0] == "track:new:1:10,10,20,20");
+  lines = events.update(one, "Face", 10);
+  assert(lines.size() == 1 && lines[0] == "1:Face:10.000000");
+
+  // Un cambio di modalita' viene notificato subito
+  lines = events.update(one, "Body", 10);
+  assert(lines.size() == 1 && lines[0] == "1:Body:10.000000");
+}
+
+// Un box che si sposta poco resta la stessa traccia, uno lontano no
+static void testIouMatching() {
+  DetectionEvents events(eventConfig(1, 5));
+
+  vector<string> lines = events.update({Rect(0, 0, 100, 100)}, "Dnn", 5);
+  assert(contains(lines, "track:new:1:0,0,100,100"));
+
+  lines = events.update({Rect(10, 10, 100, 100)}, "Dnn", 5);
+  assert(lines.empty());
+
+  lines = events.update({Rect(10, 10, 100, 100), Rect(300, 300, 50, 50)},
+                        "Dnn", 5);
+  assert(contains(lines, "track:new:2:300,300,50,50"));
+  assert(contains(lines, "2:Dnn:5.000000"));
+}
+
+// Le tracce confermate vengono perse dopo lostAfter frame senza match, quelle
+// mai confermate spariscono senza eventi
+static void testLostTracks() {
+  DetectionEvents events(eventConfig(2, 3));
+  vector<Rect> one = {Rect(10, 10, 20, 20)};
+  vector<Rect> none;
+
+  events.update(one, "Face", 10);
+  assert(contains(events.update(one, "Face", 10), "track:new:1:10,10,20,20"));
+  assert(!contains(events.update(none, "Face", 10), "track:lost:1:2"));
+  assert(!contains(events.update(none, "Face", 10), "track:lost:1:2"));
+  assert(contains(events.update(none, "Face", 10), "track:lost:1:2"));
+
+  events.update({Rect(200, 200, 20, 20)}, "Face", 10);
+  for (int i = 0; i < 3; i++) {
+    for (const auto &line : events.update(none, "Face", 10)) {
+      assert(line.rfind("track:lost", 0) != 0);
+    }
+  }
+}
+
+// L'heartbeat riassume i frame della finestra, anche quelli senza detection
+static void testHeartbeatWindow() {
+  EventConfig config = eventConfig(1, 5);
+  config.heartbeat = 0.05;
+  DetectionEvents events(config);
+  vector<Rect> two = {Rect(0, 0, 10, 10), Rect(50, 50, 10, 10)};
+
+  events.update(two, "Body", 8);
+  events.update(two, "Body", 8, 1, false);
+  events.update({}, "Body", 8);
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+
+  vector<string> lines = events.update({}, "Body", 8, 1, false);
+  assert(contains(lines, "heartbeat:Body:4:1.00:2:8.00:1"));
+
+  // Con heartbeat 0 non viene mai inviato
+  DetectionEvents silent(eventConfig(1, 5));
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for (const auto &line : silent.update(two, "Body", 8)) {
+    assert(line.rfind("heartbeat", 0) != 0);
+  }
+}
+
+// Con stride >= hysteresis i box riusati nei frame senza detection non devono
+// confermare una detection spuria
+static void testStrideRegression() {
+  DetectionEvents events(eventConfig(3, 5));
+  vector<Rect> spurious = {Rect(40, 40, 30, 30)};
+  const int stride = 4;
+
+  for (int frame = 0; frame < stride; frame++) {
+    assert(events.update(spurious, "Face", 10, 3, frame % stride == 0)
+               .empty());
+  }
+
+  // Nemmeno il count cambia prima di hysteresis detection
+  vector<Rect> none;
+  for (int frame = stride; frame < 3 * stride; frame++) {
+    assert(events.update(none, "Face", 10, 3, frame % stride == 0).empty());
+  }
+}
+
+// Degrada dopo overrun sostenuti, risale solo dopo un margine piu' lungo
+static void testQosController() {
+  QosConfig config;
+  QosController qos(config, 40);
+  assert(qos.levelIndex() == 0);
+
+  bool changed = false;
+  for (int i = 0; i < 15 && !changed; i++) changed = qos.update(60);
+  assert(changed && qos.levelIndex() == 1);
+  assert(qos.current().detectScale < 1.0);
+
+  changed = false;
+  for (int i = 0; i < 200 && !changed; i++) changed = qos.update(5);
+  assert(changed && qos.levelIndex() == 0);
+
+  // Per i detector a input fisso ogni livello riduce la detection con lo
+  // stride
+  QosController dnn(config, 40, true);
+  for (int i = 0; i < 15; i++) dnn.update(60);
+  assert(dnn.levelIndex() == 1);
+  assert(dnn.current().detectScale == 1.0 && dnn.current().stride == 2);
+
+  config.enabled = false;
+  QosController fixed(config, 40);
+  for (int i = 0; i < 100; i++) assert(!fixed.update(100));
+}
+
+static void testCpuList() {
+  cpu_set_t cpus;
+  assert(parseCpuList("0-3,8", cpus));
+  assert(CPU_COUNT(&cpus) == 5);
+  assert(formatCpuSet(cpus) == "0-3,8");
+
+  assert(parseCpuList("2", cpus) && formatCpuSet(cpus) == "2");
+  assert(!parseCpuList("", cpus));
+  assert(!parseCpuList("3-1", cpus));
+  assert(!parseCpuList("a-b", cpus));
+  assert(!parseCpuList("-1", cpus));
+}
+
+int main() {
+  testHysteresis();
+  testIouMatching();
+  testLostTracks();
+  testHeartbeatWindow();
+  testStrideRegression();
+  testQosController();
+  testCpuList();
+  return 0;
+}
@@ -4,7 +4,7 @@ import akka.actor.typed.ActorRef
 import akka.util.ByteString
 import message.{CameraMap, Config, ConfigServiceSuccess, InputServiceFailure, InputServiceSuccess, Message, SubscribeServiceFailure, SubscribeServiceSuccess}
 import router.VertxRouter
-import utils.Info
+import utils.{Info, LineBuffer}
 
 import util.ForwardConfigData
 
@@ -19,31 +19,44 @@ private class GUIBackEnd extends GenericClient:
   // Inizializziamo il router HTTP appena viene creato il Server
   vertxRouter.initRoutes()
 
+  private val lines = LineBuffer()
+  private var detectedCount: Int = 0
+
   override def startingSinkFunction(): ByteString => Unit =
-    bs => {
-      val data = bs.utf8String.strip()
-      println("SINK DATA: " + data)
-      
-      // Processa i dati nel formato "count:mode:fps"
-      val parts = data.split(":")
-      if (parts.length == 3) {
-        try {
-          val count = parts(0).toInt
-          val mode = parts(1)
-          val fps = parts(2).toDouble
-          
-          // Aggiorna il VertxRouter con questi dati
-          vertxRouter.updateDetectionData(count, mode, fps)
-
-        } catch {
-          case e: Exception =>
-            println(s"Errore nel processare i dati: $data - ${e.getMessage}")
-        }
-      } else {
-        // Se non è nel formato atteso, passa il dato originale
-        println(s"Dato ricevuto: $data")
+    bs => lines.append(bs).foreach(processLine)
+
+  // Un singolo frame puo' produrre piu' righe, es. "track:new:..." seguito da "count:mode:fps"
+  private def processLine(line: String): Unit = {
+    println("SINK DATA: " + line)
+
+    // Un nodo con piu' stream prefissa le righe con "camera<id>:": si mostrano solo quelle della camera selezionata
+    val (stream, data) = LineBuffer.splitStreamTag(line)
+    if (stream.exists(_ != vertxRouter.getCurrentCameraId)) return
+
+    val parts = data.split(":")
+    try {
+      parts(0) match {
+        // heartbeat:mode:frames:avg:max:fps:qos, inviato anche se il count non cambia
+        case "heartbeat" if parts.length == 7 =>
+          vertxRouter.updateDetectionData(detectedCount, parts(1), parts(5).toDouble)
+
+        case "track" | "qos" =>
+          println(s"Evento ricevuto: $data")
+
+        // Processa i dati nel formato "count:mode:fps"
+        case _ if parts.length == 3 =>
+          detectedCount = parts(0).toInt
+          vertxRouter.updateDetectionData(detectedCount, parts(1), parts(2).toDouble)
+
+        case _ =>
+          // Se non è nel formato atteso, passa il dato originale
+          println(s"Dato ricevuto: $data")
       }
+    } catch {
+      case e: Exception =>
+        println(s"Errore nel processare i dati: $data - ${e.getMessage}")
     }
+  }
 
   override def onMessage(msg: Message, clientInfo: Info): Unit =
     msg match {
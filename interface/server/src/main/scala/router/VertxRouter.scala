@@ -32,6 +32,8 @@ private class VertxRouter:
   private var detectionMode: String = "Initializing..."
   private var frameRate: Double = 0.0
 
+  def getCurrentCameraId: String = currentCameraId
+
   def updateDetectionData(count: Int, mode: String, fps: Double): Unit = {
     detectedCount = count
     detectionMode = mode
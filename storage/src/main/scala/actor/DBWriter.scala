@@ -25,13 +25,14 @@ import akka.util.ByteString
 import com.mongodb.client.MongoCollection
 import message.Message
 import org.bson.Document
-import utils.Info
+import utils.{Info, LineBuffer}
 
 object DBWriter:
   def apply(mongoCollection: MongoCollection[Document], cameraName: String): Behavior =
     new DBWriter(mongoCollection, cameraName).create()
 
 private class DBWriter(mongoCollection: MongoCollection[Document], cameraName: String) extends GenericClient:
+  private val lines = LineBuffer()
 
   override def onMessage(msg: Message, clientInfo: Info): Unit =
     msg match
@@ -39,5 +40,11 @@ private class DBWriter(mongoCollection: MongoCollection[Document], cameraName: S
 
   override def startingSinkFunction(): ByteString => Unit =
     bs =>
-      val doc = Document("cameraName", cameraName).append("value", bs.utf8String.strip())
-      mongoCollection.insertOne(doc)
\ No newline at end of file
+      // one document per output line, also when a chunk carries several of them
+      lines.append(bs).foreach { line =>
+        // lines of a process serving several streams also record which stream they come from
+        val (stream, value) = LineBuffer.splitStreamTag(line)
+        val doc = Document("cameraName", cameraName).append("value", value)
+        stream.foreach(tag => doc.append("stream", tag))
+        mongoCollection.insertOne(doc)
+      }
\ No newline at end of file